@@ -0,0 +1,104 @@
+#ifndef _LW_IO_THROTTLE_
+#define _LW_IO_THROTTLE_
+
+// rate limiting for background reads: token buckets on bytes/s and files/s,
+// optional backoff when reads get slow, and the io priority of the process
+
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace LW {
+
+class token_bucket
+{
+	typedef std::chrono::steady_clock clock;
+
+	double rate;   // tokens per second, 0 means unlimited
+	double burst;  // at most this many tokens are saved up while idle
+	double tokens;
+	clock::time_point last;
+
+public:
+	token_bucket(double rate = 0) : rate(rate), burst(std::max(rate/10, 1.0)), tokens(burst), last(clock::now()) {}
+
+	bool limited() const { return rate > 0; }
+
+	// blocks until n tokens are available; n may exceed the burst, then the bucket goes into debt
+	// returns the time slept
+	std::chrono::duration<double> take(double n)
+	{
+		if(! limited())
+			return std::chrono::duration<double>(0);
+
+		const clock::time_point now = clock::now();
+		tokens = std::min(burst, tokens + rate * std::chrono::duration<double>(now - last).count());
+		last = now;
+		tokens -= n;
+		if(tokens >= 0)
+			return std::chrono::duration<double>(0);
+
+		const std::chrono::duration<double> wait(-tokens / rate);
+		std::this_thread::sleep_for(wait);
+		return wait;
+	}
+};
+
+class io_throttle
+{
+	token_bucket bytes, files;
+	std::chrono::duration<double> max_latency; // 0 means no adaptive backoff
+	double backoff; // >= 1, after a slow read we stay idle (backoff-1) times as long as the read took
+	std::chrono::duration<double> slept_total;
+
+public:
+	io_throttle(double bytes_per_sec = 0, double files_per_sec = 0, double max_latency_ms = 0) :
+		bytes(bytes_per_sec), files(files_per_sec), max_latency(max_latency_ms / 1000), backoff(1), slept_total(0) {}
+
+	bool active() const { return bytes.limited() || files.limited() || max_latency.count() > 0; }
+
+	double slept() const { return slept_total.count(); }
+
+	void begin_file() { slept_total += files.take(1); }
+
+	void before_read(size_t n) { slept_total += bytes.take(n); }
+
+	// multiplicative increase of the backoff on slow reads, slow decrease on fast ones
+	void after_read(std::chrono::duration<double> latency)
+	{
+		if(max_latency.count() <= 0)
+			return;
+
+		if(latency > max_latency)
+			backoff = std::min(backoff * 2, 64.0);
+		else
+			backoff = std::max(backoff * 0.9, 1.0);
+
+		if(backoff > 1)
+		{
+			const std::chrono::duration<double> wait = latency * (backoff - 1);
+			std::this_thread::sleep_for(wait);
+			slept_total += wait;
+		}
+	}
+};
+
+// ioclass: 1 = realtime, 2 = best-effort, 3 = idle; level: 0 (highest) ... 7 (lowest)
+// same as ionice, but without the need for a wrapper. returns false on failure or on non-linux systems
+inline bool set_ioprio(int ioclass, int level)
+{
+#ifdef __linux__
+	const int ioprio_who_process = 1, ioprio_class_shift = 13;
+	return syscall(SYS_ioprio_set, ioprio_who_process, 0, (ioclass << ioprio_class_shift) | level) == 0;
+#else
+	return false;
+#endif
+}
+
+}
+
+#endif // _LW_IO_THROTTLE_
@@ -5,12 +5,16 @@
 #include <algorithm>
 #include <limits>
 #include <unordered_map>
+#include <unordered_set>
 #include <chrono>
 #include <cryptopp/sha.h>
-#include <sys/stat.h> // for chmod
+#include <sys/stat.h> // for chmod, stat, mkdir
+#include <unistd.h> // for link
+#include <cerrno>
 // #include <io.h>
 #include "bytes2str.hpp"
 #include "find_files_in_dir.hpp"
+#include "io_throttle.hpp"
 #include "string_replace.hpp"
 using namespace std;
 
@@ -28,9 +32,15 @@ int help(const string& prog_name, const string& action)
 	}
 	else if(action == "scan")
 	{
-		cout<< prog_name <<" scan DB.dat /path/to/dir [/other/path]\n"
+		cout<< prog_name <<" scan [options] DB.dat /path/to/dir [/other/path]\n"
 			"will create a database in file DB.dat for all the files found in paths (like /path/to/dir) supplied as argument.\n"
-			"It does this by applying the \"hash\" action to each file found in the supplied paths." <<endl;
+			"It does this by applying the \"hash\" action to each file found in the supplied paths.\n"
+			"Files with several hardlinks are read only once. Their lines carry the link identity after the size (size:dev:ino).\n\n"
+			"To run on a busy host, these options can be given before DB.dat:\n"
+			"--bwlimit=10M        - read at most this many bytes per second (suffixes K, M, G)\n"
+			"--files-per-sec=100  - open at most this many files per second\n"
+			"--ioprio=idle        - set the io priority like ionice, either idle, be (same as be:4) or be:0 (highest) ... be:7 (lowest)\n"
+			"--max-latency=50     - back off when a single read takes longer than this many milliseconds" <<endl;
 	}
 	else if(action == "comp")
 	{
@@ -41,14 +51,44 @@ int help(const string& prog_name, const string& action)
 			"copy-from-DB-A.sh - a script allowing to copy all files only A has to a destination (like external drive)\n"
 			"copy-from-DB-B.sh - a script allowing to copy all files only B has to a destination (like external drive)\n"
 			"matches-from-DB-A-to-DB-B.dat - line by line each path in DB-A [tab] first match in DB-B\n"
-			"matches-from-DB-B-to-DB-A.dat - line by line each path in DB-B [tab] first match in DB-A\n\n"
+			"matches-from-DB-B-to-DB-A.dat - line by line each path in DB-B [tab] first match in DB-A\n"
+			"Hardlinked files are copied once, the copy scripts recreate further links with ln (or copy them, if the destination has no hardlinks).\n\n"
 			"If /output/basedir is provided, all above output files will be created there. Otherwise, they are created in the current working directory (possibly overwriting files with the same names)."<<endl;
 	}
 	else if(action == "lsdup")
 	{
 		cout<< prog_name <<" lsdup DB.dat dup.txt\n"
 			"will scan all files that have the same hash in DB.dat (and are therefore most likely identical).\n"
-			"A report is written to dup.txt ."<<endl;
+			"A report is written to dup.txt . Hardlinks of the same file are not counted as wasted space."<<endl;
+	}
+	else if(action == "pack")
+	{
+		cout<< prog_name <<" pack DB-A.dat DB-B.dat /mnt/drive/A.pack\n"
+			"will write all files that are only in DB-A (the files copy-from-DB-A.sh would copy) into one archive file.\n"
+			"Writing one large file is much faster than many small ones on external drives.\n"
+			"Each file is checked against its fingerprint in DB-A while it is packed, changed files are skipped.\n"
+			"Hardlinks are stored once. An index of hash, size, offset and path is appended to the archive."<<endl;
+	}
+	else if(action == "unpack")
+	{
+		cout<< prog_name <<" unpack /mnt/drive/A.pack /dest/dir\n"
+			"will extract an archive created by pack below /dest/dir, in the same layout as copy-from-DB-A.sh /dest/dir would create.\n"
+			"Each extracted file is checked against the fingerprint from DB-A before it is moved into place. Files that do not match are not written."<<endl;
+	}
+	else if(action == "update")
+	{
+		cout<< prog_name <<" update DB-B.dat DB-A.dat /dest/dir\n"
+			"will add all files that are only in DB-A to DB-B.dat, with their paths below /dest/dir,\n"
+			"as after running copy-from-DB-A.sh /dest/dir or unpack /mnt/drive/A.pack /dest/dir on B's side.\n"
+			"No file is read, the hashes are taken from DB-A. Files that are missing below /dest/dir or differ in size are not added.\n"
+			"Hardlinks recreated below /dest/dir are recorded with their local link identity, as scan would do.\n"
+			"DB-B.dat is rewritten sorted by hash, so comp can run again right away."<<endl;
+	}
+	else if(action == "merge")
+	{
+		cout<< prog_name <<" merge OUT.dat DB1.dat DB2.dat [DB3.dat ...]\n"
+			"will combine the databases into OUT.dat, sorted by hash. If a path occurs in several databases, the last one wins.\n"
+			"OUT.dat may be one of the input databases. Hardlink identities are only kept from DB1.dat."<<endl;
 	}
 	else
 	{
@@ -57,9 +97,13 @@ int help(const string& prog_name, const string& action)
 			"where action is one from the following examples:\n"
 			<< prog_name <<" help [action]\n"
 			<< prog_name <<" hash /some/file.mp3 [file2.avi ...]\n"
-			<< prog_name <<" scan DB.dat /path/to/dir [/other/path]\n"
+			<< prog_name <<" scan [options] DB.dat /path/to/dir [/other/path]\n"
 			<< prog_name <<" comp DB-A.dat DB-B.dat [/output/basedir]\n"
-			<< prog_name <<" lsdup DB.dat dup.txt" <<endl;
+			<< prog_name <<" lsdup DB.dat dup.txt\n"
+			<< prog_name <<" pack DB-A.dat DB-B.dat /mnt/drive/A.pack\n"
+			<< prog_name <<" unpack /mnt/drive/A.pack /dest/dir\n"
+			<< prog_name <<" update DB-B.dat DB-A.dat /dest/dir\n"
+			<< prog_name <<" merge OUT.dat DB1.dat DB2.dat [DB3.dat ...]" <<endl;
 		
 		if(action != "")
 		{
@@ -70,43 +114,168 @@ int help(const string& prog_name, const string& action)
 	return 0;
 }
 
-int mp3hash(const string& filepath, ostream& outs=cout)
+// one line of a database file: "hash size path", or "hash size:dev:ino path" for files with several hardlinks
+struct db_entry
 {
-	const unsigned id31size = 128;
-	const unsigned hash_len = 64; // 64 bytes == 512 bits
+	string hash;
+	unsigned long long size;
+	string link; // "dev:ino" if the file has more than one hardlink, otherwise empty
+	string path;
+};
+
+db_entry parse_db_line(const string& line)
+{
+	const size_t pos = line.find(' ');
+	if(pos == string::npos)
+		throw invalid_argument("no space found");
 	
-	ifstream mp3file(filepath.c_str());
-	if(! mp3file)
+	const size_t pos2 = line.find(' ', pos+1); // find second occurrence of a space
+	if(pos2 == string::npos)
+		throw invalid_argument("no second space found");
+	
+	db_entry entry;
+	entry.hash = line.substr(0, pos);
+	const string size = line.substr(pos+1, pos2-pos-1);
+	entry.size = stoull(size); // stops at the ':' of a link identity, so older versions can still read our files
+	const size_t colon = size.find(':');
+	if(colon != string::npos)
+		entry.link = size.substr(colon+1);
+	entry.path = line.substr(pos2+1);
+	return entry;
+}
+
+// the link identity as stored in DB lines, "dev:ino"
+string link_of(const struct stat& st)
+{
+	return to_string((unsigned long long)st.st_dev) +":"+ to_string((unsigned long long)st.st_ino);
+}
+
+// identifies the inode of a hardlinked entry, empty for other entries.
+// includes the hash, so a dev:ino that occurs again (e.g. in merged DBs) can never tie different files together
+string link_key_of(const db_entry& entry)
+{
+	return entry.link.empty() ? "" : entry.hash +' '+ entry.link;
+}
+
+void write_db_line(ostream& outs, const string& hash, unsigned long long size, const string& link, const string& filepath)
+{
+	outs<< hash <<' '<< size;
+	if(! link.empty())
+		outs<<':'<< link;
+	
+	if(filepath.rfind('\n') == string::npos) // NTFS allows line breaks in filenames...
+		outs<<' '<< filepath <<endl;
+	else // try to avoid some trouble
 	{
-		cerr<<"Error: Could not open file \""<<filepath<<"\" for reading."<<endl;
+		string filepath2 = filepath;
+		replace(filepath2.begin(), filepath2.end(), '\n', ' ');
+		outs<<' '<< filepath2 <<endl;
+	}
+}
+
+int read_db(const string& DBpath, vector<db_entry>& entries)
+{
+	ifstream db_file(DBpath.c_str());
+	if(! db_file)
+	{
+		cerr<<"Error: Could not open file \""<< DBpath <<"\" for reading."<<endl;
 		return 1;
 	}
 	
-	// get file size
-	mp3file.seekg(0, ios::end);
-	unsigned filesize = mp3file.tellg();
-	mp3file.seekg(0, ios::beg);
-	if((streampos)(filesize) == (streampos)(-1)) cerr<<"Error: Could not determine size of file \""<<filepath<<"\"."<<endl;
+	string line;
+	while(db_file.good())
+	{
+		getline(db_file, line);
+		if(line.empty())
+			continue;
+		
+		try
+		{
+			entries.push_back(parse_db_line(line));
+		}
+		catch(const logic_error& e) // std::invalid_argument
+		{
+			cerr<<"# Ignored improperly formatted line \""<< line <<"\" ("<< e.what() <<")."<<endl;
+		}
+	}
+	return 0;
+}
+
+// keeps only the last entry for each path, sorts like lsdup does (by hash) and replaces DBpath
+int write_db(const string& DBpath, const vector<db_entry>& entries)
+{
+	unordered_map<string, size_t> last_of_path;
+	for(size_t i = 0; i < entries.size(); ++i)
+		last_of_path[entries[i].path] = i;
 	
-	// choosing hashing method (how much to read from file)
-	string prefix;
-	unsigned sample_size, skipback = 0;
+	vector<const db_entry*> sorted;
+	for(size_t i = 0; i < entries.size(); ++i)
+		if(last_of_path[entries[i].path] == i)
+			sorted.push_back(&entries[i]);
 	
-	if(filesize >= id31size)
+	sort(sorted.begin(), sorted.end(), [](const db_entry* a, const db_entry* b) {
+		if(a->hash != b->hash) return a->hash < b->hash;
+		return a->path < b->path;
+	});
+	
+	// write to a temporary file first, so a failure does not destroy the old DB
+	const string tmppath = DBpath + ".tmp";
+	ofstream db_file(tmppath.c_str());
+	if(! db_file)
 	{
-		// check if we got id3v1. if so, remember id3 offset (128 bytes)
-		mp3file.seekg(filesize - id31size);
-		
-		if(mp3file.get() == 'T' && mp3file.get() == 'A' && mp3file.get() == 'G')
-			skipback = id31size;
+		cerr<<"Error: Could not open file \""<< tmppath <<"\" for writing."<<endl;
+		return 1;
+	}
+	
+	for(const db_entry* e: sorted)
+		write_db_line(db_file, e->hash, e->size, e->link, e->path);
+	
+	db_file.close();
+	if(! db_file || rename(tmppath.c_str(), DBpath.c_str()) != 0)
+	{
+		cerr<<"Error: Could not write to file \""<< DBpath <<"\"."<<endl;
+		remove(tmppath.c_str());
+		return 1;
 	}
+	return 0;
+}
+
+// entries of "from" whose hash does not occur in "in"
+vector<db_entry> missing_entries(const vector<db_entry>& from, const vector<db_entry>& in)
+{
+	unordered_set<string> hashes;
+	for(const db_entry& e: in)
+		hashes.insert(e.hash);
+	
+	vector<db_entry> missing;
+	for(const db_entry& e: from)
+		if(hashes.find(e.hash) == hashes.end())
+			missing.push_back(e);
+	return missing;
+}
+
+// which part of a file the hash is taken from
+struct hash_sample
+{
+	string prefix;
+	unsigned offset;
+	unsigned size;
+};
+
+hash_sample choose_sample(unsigned filesize, bool has_id3v1)
+{
+	const unsigned id31size = 128;
+	
+	// choosing hashing method (how much to read from file)
+	string prefix;
+	unsigned sample_size, skipback = has_id3v1 ? id31size : 0; // if we got id3v1, remember id3 offset (128 bytes)
 	
 	if(filesize < 100*1024 + skipback)
 	{
-		// file is maller than 100 KiB -> read in full file to memory and hash it
+		// file is maller than 100 KiB -> read in full file (without id3v1) to memory and hash it
 		// (same result as sha512sum utility would produce)
 		prefix = "0F-";
-		sample_size = filesize;
+		sample_size = filesize - skipback;
 	}
 	else if(filesize < 1048576 + skipback)
 	{
@@ -128,17 +297,16 @@ int mp3hash(const string& filepath, ostream& outs=cout)
 		skipback += 50*1048576;
 	}
 	
-	// allocate buffer, read sample from disk to buffer and hash
-	CryptoPP::SHA512 hashsum;
+	return {prefix, filesize - sample_size - skipback, sample_size};
+}
+
+// generate hash as hexadecimal string
+string sha512_hex(CryptoPP::SHA512& hashsum)
+{
+	const unsigned hash_len = 64; // 64 bytes == 512 bits
 	byte sha512hash[hash_len];
-	char* sample_buffer = new char[sample_size];
-	mp3file.seekg(filesize - sample_size - skipback);
-	mp3file.read(sample_buffer, sample_size);
-	hashsum.Update((byte*)sample_buffer, sample_size);
 	hashsum.Final(sha512hash);
-	delete [] sample_buffer;
 	
-	// generate hash as hexadecimal string
 	string hexhash(2*hash_len, 0);
 	const unsigned char hex[] = "0123456789abcdef";
 	unsigned n = 0;
@@ -151,21 +319,142 @@ int mp3hash(const string& filepath, ostream& outs=cout)
 			hexhash[n++] = hex[c % 16];
 		}
 	}
-	const string mp3hash_ascii = prefix+hexhash;
+	return hexhash;
+}
+
+int fingerprint(const string& filepath, string& mp3hash_ascii, unsigned& filesize, LW::io_throttle* throttle=nullptr)
+{
+	const unsigned id31size = 128;
 	
-	if(filepath.rfind('\n') == string::npos) // NTFS allows line breaks in filenames...
-		outs<< mp3hash_ascii <<' '<< filesize <<' '<< filepath <<endl;
-	else // try to avoid some trouble
+	ifstream mp3file(filepath.c_str());
+	if(! mp3file)
 	{
-		string filepath2 = filepath;
-		replace(filepath2.begin(), filepath2.end(), '\n', ' ');
-		outs<< mp3hash_ascii <<' '<< filesize <<' '<< filepath2 <<endl;
+		cerr<<"Error: Could not open file \""<<filepath<<"\" for reading."<<endl;
+		return 1;
 	}
 	
+	if(throttle)
+		throttle->begin_file();
+	
+	// get file size
+	mp3file.seekg(0, ios::end);
+	filesize = mp3file.tellg();
+	mp3file.seekg(0, ios::beg);
+	if((streampos)(filesize) == (streampos)(-1)) cerr<<"Error: Could not determine size of file \""<<filepath<<"\"."<<endl;
+	
+	bool has_id3v1 = false;
+	if(filesize >= id31size)
+	{
+		// check if we got id3v1
+		mp3file.seekg(filesize - id31size);
+		
+		if(mp3file.get() == 'T' && mp3file.get() == 'A' && mp3file.get() == 'G')
+			has_id3v1 = true;
+	}
+	const hash_sample sample = choose_sample(filesize, has_id3v1);
+	
+	// allocate buffer, read sample from disk to buffer chunk by chunk and hash
+	// (smaller reads let the throttle spread the load instead of doing 1 MiB bursts)
+	const unsigned chunk_size = 64*1024;
+	CryptoPP::SHA512 hashsum;
+	char* sample_buffer = new char[min(sample.size, chunk_size)];
+	mp3file.seekg(sample.offset);
+	for(unsigned done = 0; done < sample.size; )
+	{
+		const unsigned n = min(sample.size - done, chunk_size);
+		if(throttle)
+			throttle->before_read(n);
+		
+		const auto r0 = chrono::steady_clock::now();
+		mp3file.read(sample_buffer, n);
+		if(throttle)
+			throttle->after_read(chrono::steady_clock::now() - r0);
+		
+		hashsum.Update((byte*)sample_buffer, n);
+		done += n;
+	}
+	delete [] sample_buffer;
+	
+	mp3hash_ascii = sample.prefix + sha512_hex(hashsum);
+	
+	return 0;
+}
+
+// computes the same hash as fingerprint() from data that streams through once, start to end.
+// as the id3v1 tag is only seen at the end, the samples with and without it are both hashed.
+class stream_fingerprint
+{
+	static const unsigned id31size = 128;
+	unsigned filesize;
+	hash_sample samples[2]; // without, with id3v1
+	CryptoPP::SHA512 hashsums[2];
+	char tag[3];
+	unsigned long long pos;
+	
+	// feed the part of data (at file position pos) that lies in [from, from+len)
+	template<typename F>
+	void overlap(const char* data, size_t n, unsigned long long from, unsigned long long len, F f)
+	{
+		const unsigned long long lo = max(pos, from), hi = min(pos + n, from + len);
+		if(lo < hi)
+			f(data + (lo - pos), hi - lo, lo - from);
+	}
+	
+public:
+	stream_fingerprint(unsigned filesize) : filesize(filesize), samples{choose_sample(filesize, false), choose_sample(filesize, filesize >= id31size)}, tag{0, 0, 0}, pos(0) {}
+	
+	void update(const char* data, size_t n)
+	{
+		for(int t = 0; t < 2; ++t)
+			overlap(data, n, samples[t].offset, samples[t].size, [this, t](const char* d, size_t m, unsigned long long) {
+				hashsums[t].Update((const byte*)d, m);
+			});
+		if(filesize >= id31size)
+			overlap(data, n, filesize - id31size, 3, [this](const char* d, size_t m, unsigned long long at) {
+				copy(d, d + m, tag + at);
+			});
+		pos += n;
+	}
+	
+	string result()
+	{
+		const int t = (filesize >= id31size && tag[0] == 'T' && tag[1] == 'A' && tag[2] == 'G') ? 1 : 0;
+		return samples[t].prefix + sha512_hex(hashsums[t]);
+	}
+};
+
+// "10M" -> 10485760, suffixes K, M and G are binary
+double parse_rate(const string& value)
+{
+	size_t end;
+	double rate = stod(value, &end);
+	const string suffix = value.substr(end);
+	if(suffix == "k" || suffix == "K")
+		rate *= 1024;
+	else if(suffix == "m" || suffix == "M")
+		rate *= 1048576;
+	else if(suffix == "g" || suffix == "G")
+		rate *= 1073741824;
+	else if(! suffix.empty())
+		throw invalid_argument("unknown suffix");
+	
+	if(rate < 0)
+		throw invalid_argument("negative rate");
+	return rate;
+}
+
+int mp3hash(const string& filepath, ostream& outs=cout, LW::io_throttle* throttle=nullptr)
+{
+	string hash;
+	unsigned filesize;
+	if(fingerprint(filepath, hash, filesize, throttle) != 0)
+		return 1;
+	
+	write_db_line(outs, hash, filesize, "", filepath);
 	return 0;
 }
 
-int scan(const string& DBpath, const vector<string>& dirpaths)
+int scan(const string& DBpath, const vector<string>& dirpaths, LW::io_throttle& throttle)
 {
 	const auto t0 = chrono::high_resolution_clock::now();
 	
@@ -178,16 +467,47 @@ int scan(const string& DBpath, const vector<string>& dirpaths)
 	
 	cout<<"Scanning files... (Please wait.)"<<endl;
 	
+	// files with several hardlinks are only read once, further links reuse the hash of their inode
+	unordered_map<string, pair<string, unsigned>> inode_hashes; // "dev:ino" -> (hash, size)
+	unsigned long long n_links = 0;
+	
 	// mimic find $dirpath -find f -exec mp3hash {} \;
-	auto hash2file = [&db_file](const string& fileToBeHashed) {
-		mp3hash(fileToBeHashed, db_file);
+	auto hash2file = [&db_file, &inode_hashes, &n_links, &throttle](const string& fileToBeHashed) {
+		struct stat st;
+		if(stat(fileToBeHashed.c_str(), &st) != 0 || st.st_nlink < 2)
+		{
+			mp3hash(fileToBeHashed, db_file, &throttle);
+			return;
+		}
+		
+		const string link = link_of(st);
+		const auto known = inode_hashes.find(link);
+		if(known != inode_hashes.end())
+		{
+			write_db_line(db_file, known->second.first, known->second.second, link, fileToBeHashed);
+			++n_links;
+			return;
+		}
+		
+		string hash;
+		unsigned filesize;
+		if(fingerprint(fileToBeHashed, hash, filesize, &throttle) == 0)
+		{
+			inode_hashes[link] = make_pair(hash, filesize);
+			write_db_line(db_file, hash, filesize, link, fileToBeHashed);
+		}
 	};
 	
 	for(auto& dirpath: dirpaths)
 		find_files_in_dir(dirpath, hash2file);
 	
 	const auto t1 = chrono::high_resolution_clock::now();
-	cout<<"Created database file \""<< DBpath <<"\" in about "<< chrono::duration_cast<chrono::seconds>(t1-t0).count() <<" seconds."<<endl;
+	cout<<"Created database file \""<< DBpath <<"\" in about "<< chrono::duration_cast<chrono::seconds>(t1-t0).count() <<" seconds.";
+	if(n_links > 0)
+		cout<<" "<< n_links <<" hardlinks were not read again.";
+	if(throttle.active())
+		cout<<" Throttling paused reading for about "<< (unsigned long long)throttle.slept() <<" seconds.";
+	cout<<endl;
 	
 	return 0;
 }
@@ -272,7 +592,8 @@ int comp(const string (&dbPaths)[2], const string (&onlyPaths)[2], const string
 	{
 		string line, line2;
 		unsigned long long mem_sum = 0;
-		vector<string> missing_files;
+		vector<pair<string, string>> missing_files; // (path, link key)
+		unordered_set<string> counted_links; // hardlinks take disk memory only once
 		const auto not_found = ummap[1-f].end();
 		for(const auto& element: ummap[f])
 		{
@@ -281,26 +602,20 @@ int comp(const string (&dbPaths)[2], const string (&onlyPaths)[2], const string
 			if(! db_files[f].good()) cerr<<"! db_files["<<f<<"]"<<endl;
 			try
 			{
-				const size_t pos = line.find(' ');
-				if(pos == string::npos)
-					throw invalid_argument("no space found");
-				
-				const size_t pos2 = line.find(' ', pos+1); // find second occurrence of a space
-				if(pos2 == string::npos)
-					throw invalid_argument("no second space found");
-				
-				const string path = line.substr(pos2+1);
+				const db_entry entry = parse_db_line(line);
 				const auto first_matching_partner = ummap[1-f].find(element.first);
 				if(first_matching_partner == not_found) // if in file (f), but not in file (1-f)
 				{
-					missing_files.push_back(path); // remember missing path
-					mem_sum += stoull(line.substr(pos+1, pos2)); // add up file sizes
+					const string link_key = link_key_of(entry);
+					missing_files.push_back(make_pair(entry.path, link_key)); // remember missing path
+					if(link_key.empty() || counted_links.insert(link_key).second)
+						mem_sum += entry.size; // add up file sizes
 				}
 				else
 				{
 					db_files[1-f].seekg(first_matching_partner->second);
 					getline(db_files[1-f], line2);
-					match_files[f] << path <<"\t"<< &line2.at(line2.find(' ', line2.find(' ')+1)+1) <<"\n";
+					match_files[f] << entry.path <<"\t"<< parse_db_line(line2).path <<"\n";
 				}
 			}
 			catch(const logic_error& e) // std::invalid_argument
@@ -316,7 +631,7 @@ int comp(const string (&dbPaths)[2], const string (&onlyPaths)[2], const string
 		
 		// write diff to txt files
 		for(auto& missing_file: missing_files)
-			txt_files[f] << missing_file << '\n';
+			txt_files[f] << missing_file.first << '\n';
 		
 		// write diff to sh files
 		// get common prefix
@@ -328,9 +643,9 @@ int comp(const string (&dbPaths)[2], const string (&onlyPaths)[2], const string
 			ppos = common_prefix.length();
 			for(auto& missing_file: missing_files)
 			{
-				if(missing_file.empty()) continue;
+				if(missing_file.first.empty()) continue;
 				for(size_t i = 0; i < ppos; ++i)
-					if(common_prefix[i] != missing_file[i])
+					if(common_prefix[i] != missing_file.first[i])
 						ppos = i;
 			}
 			// common_prefix = common_prefix.substr(0, ppos);
@@ -340,8 +655,8 @@ int comp(const string (&dbPaths)[2], const string (&onlyPaths)[2], const string
 		string last_dir = "#";
 		for(auto& missing_file: missing_files)
 		{
-			const size_t pos_last_slash = missing_file.rfind('/');
-			const string dir = missing_file.substr(ppos, pos_last_slash>ppos ? pos_last_slash-ppos : string::npos);
+			const size_t pos_last_slash = missing_file.first.rfind('/');
+			const string dir = missing_file.first.substr(ppos, pos_last_slash>ppos ? pos_last_slash-ppos : string::npos);
 			if(dir != last_dir)
 			{
 				last_dir = dir;
@@ -349,11 +664,24 @@ int comp(const string (&dbPaths)[2], const string (&onlyPaths)[2], const string
 			}
 		}
 		
-		// cp commands
+		// cp commands, further hardlinks of an already copied inode are recreated with ln,
+		// or copied where the destination cannot hold hardlinks (e.g. FAT, exFAT)
+		unordered_map<string, string> linked_dests; // link key -> dest_path of its first copy
 		for(auto& missing_file: missing_files)
 		{
-			string dest_path = missing_file.substr(ppos, string::npos);
-			sh_files[f]<<"cp \""<< string_replace(missing_file, "`", "\\`") <<"\" \"$dest/"<< dest_path <<"\"\n";
+			string dest_path = missing_file.first.substr(ppos, string::npos);
+			if(! missing_file.second.empty())
+			{
+				const auto first_copy = linked_dests.find(missing_file.second);
+				if(first_copy != linked_dests.end())
+				{
+					sh_files[f]<<"ln \"$dest/"<< first_copy->second <<"\" \"$dest/"<< dest_path <<"\" 2>/dev/null || "
+						"cp \""<< string_replace(missing_file.first, "`", "\\`") <<"\" \"$dest/"<< dest_path <<"\"\n";
+					continue;
+				}
+				linked_dests[missing_file.second] = dest_path;
+			}
+			sh_files[f]<<"cp \""<< string_replace(missing_file.first, "`", "\\`") <<"\" \"$dest/"<< dest_path <<"\"\n";
 		}
 	}
 	
@@ -382,15 +710,34 @@ int lsdup(const string& DBpath, const string& duppath)
 		return 1;
 	}
 	
-	vector<string> lines;
+	vector<db_entry> entries;
 	string line;
 	while(db_file.good())
 	{
 		getline(db_file, line);
-		lines.push_back(line);
+		if(line.empty())
+			continue;
+		
+		try
+		{
+			db_entry entry = parse_db_line(line);
+			if(entry.path.empty())
+				throw invalid_argument("empty path");
+			
+			entries.push_back(entry);
+		}
+		catch(const logic_error& e)
+		{
+			cerr<<"# Ignored improperly formatted line \""<< line <<"\"... ("<< e.what() <<")."<<endl;
+		}
 	}
 	
-	sort(lines.begin(), lines.end()); // after sort, same hashes will be on consecutive lines
+	// after sort, same hashes will be consecutive, and hardlinks of the same inode within them
+	sort(entries.begin(), entries.end(), [](const db_entry& a, const db_entry& b) {
+		if(a.hash != b.hash) return a.hash < b.hash;
+		if(a.link != b.link) return a.link < b.link;
+		return a.path < b.path;
+	});
 	
 	struct dup_group
 	{
@@ -399,51 +746,29 @@ int lsdup(const string& DBpath, const string& duppath)
 	};
 	vector<dup_group> dup_groups;
 	
+	// hardlinks of one inode do not take extra disk memory, so only distinct inodes count as duplicates
 	unsigned long long wasted_mem = 0;
-	string last_hash = "#", last_path = "#";
-	unsigned long long last_mem = 0;
-	bool last_were_equal = false;
-	for(auto& line: lines)
+	for(size_t i = 0; i < entries.size(); )
 	{
-		try
+		size_t j = i;
+		unsigned n_inodes = 0;
+		dup_group g = {0, {}};
+		for(; j < entries.size() && entries[j].hash == entries[i].hash; ++j)
 		{
-			const size_t pos = line.find(' ');
-			if(pos == string::npos)
-				throw invalid_argument("no space found");
-			
-			const size_t pos2 = line.find(' ', pos+1);
-			if(pos2 == string::npos)
-				throw invalid_argument("no second space found");
-			
-			const string hash = line.substr(0, pos);
-			const string size = line.substr(pos+1, pos2);
-			const string path = line.substr(pos2+1);
-			if(path.empty())
-				throw invalid_argument("empty path");
-			
-			const unsigned long long mem = stoull(size);
-			const bool hashes_are_equal = (hash == last_hash);
-			if(hashes_are_equal)
+			if(entries[j].link.empty() || j == i || entries[j].link != entries[j-1].link)
 			{
-				if(last_were_equal)
-				{
-					dup_groups.back().mem_sum += mem;
-					dup_groups.back().paths.push_back(path);
-					wasted_mem += mem;
-				}
-				else
-					dup_groups.push_back({last_mem + mem, {last_path, path}});
+				++n_inodes;
+				g.mem_sum += entries[j].size;
 			}
-			last_were_equal = hashes_are_equal;
-			
-			last_hash = hash;
-			last_path = path;
-			last_mem  = mem;
+			g.paths.push_back(entries[j].path);
 		}
-		catch(const logic_error& e)
+		
+		if(n_inodes > 1)
 		{
-			cerr<<"# Ignored improperly formatted line \""<< line <<"\"... ("<< e.what() <<")."<<endl;
+			wasted_mem += g.mem_sum - entries[i].size;
+			dup_groups.push_back(g);
 		}
+		i = j;
 	}
 	
 	// sort groups descending by memory
@@ -466,6 +791,414 @@ int lsdup(const string& DBpath, const string& duppath)
 	return 0;
 }
 
+// path below the destination directory, like the copy scripts use it
+string dest_relpath(const string& path)
+{
+	const size_t pos = path.find_first_not_of('/');
+	return (pos == string::npos) ? "" : path.substr(pos);
+}
+
+// do not let an archive write outside of the destination directory
+bool is_safe_relpath(const string& relpath)
+{
+	if(relpath.empty() || relpath[0] == '/')
+		return false;
+	
+	const string wrapped = "/" + relpath + "/";
+	return wrapped.find("/../") == string::npos;
+}
+
+// like mkdir -p for the directory part of filepath
+bool mkdir_parents(const string& filepath)
+{
+	for(size_t pos = filepath.find('/', 1); pos != string::npos; pos = filepath.find('/', pos+1))
+	{
+		const string dir = filepath.substr(0, pos);
+		if(mkdir(dir.c_str(), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) != 0 && errno != EEXIST)
+		{
+			cerr<<"Error: Could not create directory \""<< dir <<"\"."<<endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// copies exactly n bytes (as far as in has them), returns the number of bytes copied
+unsigned long long copy_bytes(istream& in, ostream& out, unsigned long long n, stream_fingerprint* fp=nullptr)
+{
+	const size_t buffer_size = 1048576;
+	vector<char> buffer(buffer_size);
+	unsigned long long done = 0;
+	while(done < n && in.good())
+	{
+		in.read(buffer.data(), min<unsigned long long>(buffer_size, n - done));
+		out.write(buffer.data(), in.gcount());
+		if(fp)
+			fp->update(buffer.data(), in.gcount());
+		done += in.gcount();
+	}
+	return done;
+}
+
+/*
+archive format, written and read strictly sequentially:
+M3DSYNC-PACK 1
+F hash size relpath        followed by size bytes of file data
+L hash size n relpath      hardlink to the n-th entry (counting from 0), no data
+...
+INDEX count
+hash size offset relpath   one line per entry, offset of its F line (for L entries, of the linked F line)
+...
+END offset                 offset of the INDEX line
+*/
+const string pack_magic = "M3DSYNC-PACK 1";
+
+int pack(const string (&dbPaths)[2], const string& archivepath)
+{
+	const auto t0 = chrono::high_resolution_clock::now();
+	
+	vector<db_entry> dbs[2];
+	for(int f = 0; f < 2; ++f)
+		if(read_db(dbPaths[f], dbs[f]) != 0)
+			return 1;
+	
+	// everything in the first DB that has no match in the second one goes into the archive
+	vector<db_entry> missing = missing_entries(dbs[0], dbs[1]);
+	sort(missing.begin(), missing.end(), [](const db_entry& a, const db_entry& b) {return a.path < b.path;});
+	
+	ofstream archive(archivepath.c_str(), ios::binary);
+	if(! archive)
+	{
+		cerr<<"Error: Could not open file \""<< archivepath <<"\" for writing."<<endl;
+		return 1;
+	}
+	archive<< pack_magic <<'\n';
+	
+	struct index_entry
+	{
+		string hash;
+		unsigned long long size;
+		unsigned long long offset;
+		string relpath;
+	};
+	vector<index_entry> index;
+	unordered_map<string, size_t> linked_entries; // link key -> entry number of its first copy
+	unsigned long long mem_sum = 0;
+	unsigned n_skipped = 0;
+	for(const db_entry& entry: missing)
+	{
+		const string relpath = dest_relpath(entry.path);
+		if(! is_safe_relpath(relpath))
+		{
+			cerr<<"# Skipped \""<< entry.path <<"\" (unsuitable path)."<<endl;
+			++n_skipped;
+			continue;
+		}
+		
+		if(! entry.link.empty())
+		{
+			const auto first_copy = linked_entries.find(link_key_of(entry));
+			if(first_copy != linked_entries.end())
+			{
+				archive<<"L "<< entry.hash <<' '<< entry.size <<' '<< first_copy->second <<' '<< relpath <<'\n';
+				index.push_back({entry.hash, entry.size, index[first_copy->second].offset, relpath});
+				continue;
+			}
+		}
+		
+		struct stat st;
+		ifstream in(entry.path.c_str(), ios::binary);
+		if(! in || stat(entry.path.c_str(), &st) != 0)
+		{
+			cerr<<"Error: Could not open file \""<< entry.path <<"\" for reading."<<endl;
+			++n_skipped;
+			continue;
+		}
+		
+		// the data is hashed as it is copied, so the archive holds exactly what matched the DB.
+		// if it does not match (any more), the entry is taken back by overwriting it with the next one
+		const unsigned long long size = st.st_size;
+		const unsigned long long offset = archive.tellp();
+		archive<<"F "<< entry.hash <<' '<< size <<' '<< relpath <<'\n';
+		stream_fingerprint fp(size); // truncated to unsigned, like in fingerprint()
+		if(copy_bytes(in, archive, size, &fp) != size || fp.result() != entry.hash)
+		{
+			cerr<<"# Skipped \""<< entry.path <<"\" (changed since the DB was created)."<<endl;
+			archive.seekp(offset);
+			++n_skipped;
+			continue;
+		}
+		
+		if(! entry.link.empty())
+			linked_entries[link_key_of(entry)] = index.size();
+		index.push_back({entry.hash, size, offset, relpath});
+		mem_sum += size;
+	}
+	
+	const unsigned long long index_offset = archive.tellp();
+	archive<<"INDEX "<< index.size() <<'\n';
+	for(const index_entry& e: index)
+		archive<< e.hash <<' '<< e.size <<' '<< e.offset <<' '<< e.relpath <<'\n';
+	archive<<"END "<< index_offset <<'\n';
+	
+	// cut off what is left of a skipped last entry
+	const unsigned long long archive_size = archive.tellp();
+	archive.close();
+	if(! archive || truncate(archivepath.c_str(), archive_size) != 0)
+	{
+		cerr<<"Error: Could not write to file \""<< archivepath <<"\"."<<endl;
+		return 1;
+	}
+	
+	const auto t1 = chrono::high_resolution_clock::now();
+	cout<<"Packed "<< index.size() <<" of "<< missing.size() <<" files only in first DB ("<< LW::bytes2str(mem_sum) <<") "
+		"into \""<< archivepath <<"\" in about "<< chrono::duration_cast<chrono::seconds>(t1-t0).count() <<" seconds."<<endl;
+	
+	return n_skipped == 0 ? 0 : 1;
+}
+
+int unpack(const string& archivepath, const string& destdir)
+{
+	const auto t0 = chrono::high_resolution_clock::now();
+	
+	ifstream archive(archivepath.c_str(), ios::binary);
+	if(! archive)
+	{
+		cerr<<"Error: Could not open file \""<< archivepath <<"\" for reading."<<endl;
+		return 1;
+	}
+	
+	string line;
+	getline(archive, line);
+	if(line != pack_magic)
+	{
+		cerr<<"Error: \""<< archivepath <<"\" is not an archive created by pack."<<endl;
+		return 1;
+	}
+	
+	struct unpacked_entry
+	{
+		string dest_path;
+		string hash;
+		bool ok; // verified and in place
+	};
+	vector<unpacked_entry> unpacked; // by entry number
+	unsigned long long mem_sum = 0;
+	unsigned n_failed = 0;
+	bool complete = false;
+	for(;;)
+	{
+		const unsigned long long line_offset = archive.tellg();
+		if(! getline(archive, line))
+			break;
+		
+		try
+		{
+			if(line.compare(0, 6, "INDEX ") == 0)
+			{
+				if(stoull(line.substr(6)) != unpacked.size())
+					throw invalid_argument("number of entries does not match");
+				
+				for(size_t i = 0; i < unpacked.size(); ++i)
+					if(! getline(archive, line))
+						throw invalid_argument("index is truncated");
+				
+				if(! getline(archive, line) || line.compare(0, 4, "END ") != 0 || stoull(line.substr(4)) != line_offset)
+					throw invalid_argument("END line is missing or wrong");
+				
+				complete = true;
+				break;
+			}
+			
+			if(line.size() < 2 || (line[0] != 'F' && line[0] != 'L') || line[1] != ' ')
+				throw invalid_argument("unknown entry type");
+			
+			// the rest of an entry line is "hash size [n] relpath", the same layout as a DB line
+			db_entry entry = parse_db_line(line.substr(2));
+			size_t target = 0;
+			if(line[0] == 'L')
+			{
+				const size_t pos = entry.path.find(' ');
+				if(pos == string::npos)
+					throw invalid_argument("no link target found");
+				
+				target = stoull(entry.path.substr(0, pos));
+				entry.path = entry.path.substr(pos+1);
+				if(target >= unpacked.size())
+					throw invalid_argument("link target out of range");
+			}
+			if(! is_safe_relpath(entry.path))
+				throw invalid_argument("unsafe path");
+			
+			// everything is written to a temporary name next to the destination first and renamed when it is complete,
+			// so an existing file is only replaced by a verified one, and an interrupted run leaves no half written files
+			const string dest_path = destdir + "/" + entry.path;
+			const string tmp_path = dest_path + ".m3dsync-part";
+			unpacked.push_back({dest_path, entry.hash, false});
+			
+			// a link to a file that failed would be a link to nothing, or to whatever was there before
+			if(line[0] == 'L' && ! (unpacked[target].ok && unpacked[target].hash == entry.hash))
+			{
+				cerr<<"Error: \""<< dest_path <<"\" was not created, the file it links to failed."<<endl;
+				++n_failed;
+				continue;
+			}
+			
+			if(! mkdir_parents(dest_path))
+			{
+				++n_failed;
+				if(line[0] == 'F')
+					archive.ignore(entry.size);
+				continue;
+			}
+			
+			if(line[0] == 'L')
+			{
+				remove(tmp_path.c_str());
+				bool created = (link(unpacked[target].dest_path.c_str(), tmp_path.c_str()) == 0);
+				if(! created) // e.g. exFAT, fall back to a copy, verified like an F entry
+				{
+					ifstream in(unpacked[target].dest_path.c_str(), ios::binary);
+					ofstream out(tmp_path.c_str(), ios::binary);
+					stream_fingerprint fp(entry.size);
+					created = (in && out && copy_bytes(in, out, entry.size, &fp) == entry.size);
+					out.close();
+					created = created && out && fp.result() == entry.hash;
+				}
+				if(! created || rename(tmp_path.c_str(), dest_path.c_str()) != 0)
+				{
+					cerr<<"Error: Could not create \""<< dest_path <<"\"."<<endl;
+					remove(tmp_path.c_str());
+					++n_failed;
+				}
+				else
+					unpacked.back().ok = true;
+				continue;
+			}
+			
+			ofstream out(tmp_path.c_str(), ios::binary);
+			if(! out)
+			{
+				cerr<<"Error: Could not open file \""<< tmp_path <<"\" for writing."<<endl;
+				archive.ignore(entry.size);
+				++n_failed;
+				continue;
+			}
+			// verify against the fingerprint from the sender's DB while the data streams through
+			stream_fingerprint fp(entry.size); // truncated to unsigned, like in fingerprint()
+			const bool truncated = (copy_bytes(archive, out, entry.size, &fp) != entry.size);
+			out.close();
+			if(truncated)
+			{
+				remove(tmp_path.c_str());
+				throw invalid_argument("archive is truncated");
+			}
+			
+			if(! out || fp.result() != entry.hash)
+			{
+				cerr<<"Error: \""<< dest_path <<"\" does not match its fingerprint, it was not written."<<endl;
+				remove(tmp_path.c_str());
+				++n_failed;
+			}
+			else if(rename(tmp_path.c_str(), dest_path.c_str()) != 0)
+			{
+				cerr<<"Error: Could not rename \""<< tmp_path <<"\" to \""<< dest_path <<"\"."<<endl;
+				remove(tmp_path.c_str());
+				++n_failed;
+			}
+			else
+			{
+				unpacked.back().ok = true;
+				mem_sum += entry.size;
+			}
+		}
+		catch(const logic_error& e) // std::invalid_argument
+		{
+			cerr<<"Error: Broken archive entry \""<< line <<"\" ("<< e.what() <<")."<<endl;
+			return 1;
+		}
+	}
+	
+	if(! complete)
+	{
+		cerr<<"Error: \""<< archivepath <<"\" is incomplete."<<endl;
+		return 1;
+	}
+	
+	const auto t1 = chrono::high_resolution_clock::now();
+	cout<<"Unpacked "<< unpacked.size() - n_failed <<" of "<< unpacked.size() <<" files ("<< LW::bytes2str(mem_sum) <<") "
+		"into \""<< destdir <<"\" in about "<< chrono::duration_cast<chrono::seconds>(t1-t0).count() <<" seconds."<<endl;
+	
+	return n_failed == 0 ? 0 : 1;
+}
+
+int update(const string& DBpath, const string& otherDBpath, const string& destdir)
+{
+	const auto t0 = chrono::high_resolution_clock::now();
+	
+	vector<db_entry> entries, other;
+	if(read_db(DBpath, entries) != 0 || read_db(otherDBpath, other) != 0)
+		return 1;
+	
+	// the files copy-from-other.sh (or unpack) put below destdir, their hashes are already known.
+	// only files that actually arrived are added, checked by their size without reading them
+	const vector<db_entry> copied = missing_entries(other, entries);
+	unsigned n_added = 0;
+	for(db_entry e: copied)
+	{
+		e.path = destdir + "/" + dest_relpath(e.path);
+		
+		// sizes in DBs are what fingerprint() measured, which is truncated for files beyond 4 GiB
+		struct stat st;
+		if(stat(e.path.c_str(), &st) != 0 || ! S_ISREG(st.st_mode) || ((unsigned long long)st.st_size != e.size && (unsigned)st.st_size != e.size))
+		{
+			cerr<<"# Not added \""<< e.path <<"\" (missing or of different size)."<<endl;
+			continue;
+		}
+		
+		// the other host's inode numbers mean nothing here, but the copy scripts and unpack recreate its links locally
+		e.link = (st.st_nlink > 1) ? link_of(st) : "";
+		entries.push_back(e);
+		++n_added;
+	}
+	
+	if(write_db(DBpath, entries) != 0)
+		return 1;
+	
+	const auto t1 = chrono::high_resolution_clock::now();
+	cout<<"Added "<< n_added <<" of "<< copied.size() <<" files from \""<< otherDBpath <<"\" below \""<< destdir <<"\" to \""<< DBpath <<"\" in about "
+		<< chrono::duration_cast<chrono::milliseconds>(t1-t0).count() <<" ms."<<endl;
+	
+	return 0;
+}
+
+int merge(const string& outpath, const vector<string>& DBpaths)
+{
+	const auto t0 = chrono::high_resolution_clock::now();
+	
+	// link identities are only kept from the first DB, the inode numbers of the others may mean something else
+	vector<db_entry> entries;
+	for(size_t d = 0; d < DBpaths.size(); ++d)
+	{
+		const size_t first_new = entries.size();
+		if(read_db(DBpaths[d], entries) != 0)
+			return 1;
+		
+		if(d > 0)
+			for(size_t i = first_new; i < entries.size(); ++i)
+				entries[i].link.clear();
+	}
+	
+	if(write_db(outpath, entries) != 0)
+		return 1;
+	
+	const auto t1 = chrono::high_resolution_clock::now();
+	cout<<"Merged "<< DBpaths.size() <<" databases into \""<< outpath <<"\" in about "
+		<< chrono::duration_cast<chrono::milliseconds>(t1-t0).count() <<" ms."<<endl;
+	
+	return 0;
+}
+
 int main(int argc, char** argv)
 {
 	// handle command line arguments and call above functions accordingly
@@ -491,15 +1224,66 @@ int main(int argc, char** argv)
 	}
 	else if(action == "scan")
 	{
-		if(argc <= 3)
+		// options like --bwlimit=10M come before DB.dat
+		double bytes_per_sec = 0, files_per_sec = 0, max_latency_ms = 0;
+		int k = 2;
+		for(; k < argc && string(argv[k]).compare(0, 2, "--") == 0; ++k)
+		{
+			const string option = argv[k];
+			const size_t eq = option.find('=');
+			const string name  = option.substr(0, eq);
+			const string value = (eq == string::npos) ? "" : option.substr(eq+1);
+			try
+			{
+				if(name == "--bwlimit")
+					bytes_per_sec = parse_rate(value);
+				else if(name == "--files-per-sec")
+					files_per_sec = parse_rate(value);
+				else if(name == "--max-latency")
+				{
+					size_t end;
+					max_latency_ms = stod(value, &end);
+					if(end != value.size())
+						throw invalid_argument("expected milliseconds without unit");
+					if(max_latency_ms < 0)
+						throw invalid_argument("negative latency");
+				}
+				else if(name == "--ioprio")
+				{
+					// idle, be (level 4, like ionice) or be:0 ... be:7
+					int ioclass, level;
+					if(value == "idle")
+						ioclass = 3, level = 0;
+					else if(value == "be")
+						ioclass = 2, level = 4;
+					else if(value.length() == 4 && value.compare(0, 3, "be:") == 0 && value[3] >= '0' && value[3] <= '7')
+						ioclass = 2, level = value[3] - '0';
+					else
+						throw invalid_argument("expected idle, be or be:0 ... be:7");
+					
+					if(! LW::set_ioprio(ioclass, level))
+						cerr<<"Warning: Could not set io priority."<<endl;
+				}
+				else
+					throw invalid_argument("unknown option");
+			}
+			catch(const logic_error& e)
+			{
+				cerr<<"Error: Invalid option \""<< option <<"\" ("<< e.what() <<")."<<endl;
+				return 1;
+			}
+		}
+		
+		if(argc <= k+1)
 			return help(prog_name, action);
 		
-		const string DBpath  = argv[2];
+		const string DBpath  = argv[k];
 		vector<string> dirpaths;
-		for(int k = 3; k < argc; ++k)
+		for(++k; k < argc; ++k)
 			dirpaths.push_back(argv[k]);
 		
-		return scan(DBpath, dirpaths);
+		LW::io_throttle throttle(bytes_per_sec, files_per_sec, max_latency_ms);
+		return scan(DBpath, dirpaths, throttle);
 	}
 	else if(action == "comp")
 	{
@@ -533,6 +1317,49 @@ int main(int argc, char** argv)
 		
 		return lsdup(DBpath, duppath);
 	}
+	else if(action == "pack")
+	{
+		if(argc <= 4)
+			return help(prog_name, action);
+		
+		const string dbPaths[2] = {argv[2], argv[3]};
+		const string archivepath = argv[4];
+		
+		return pack(dbPaths, archivepath);
+	}
+	else if(action == "unpack")
+	{
+		if(argc <= 3)
+			return help(prog_name, action);
+		
+		const string archivepath = argv[2];
+		const string destdir = argv[3];
+		
+		return unpack(archivepath, destdir);
+	}
+	else if(action == "update")
+	{
+		if(argc <= 4)
+			return help(prog_name, action);
+		
+		const string DBpath = argv[2];
+		const string otherDBpath = argv[3];
+		const string destdir = argv[4];
+		
+		return update(DBpath, otherDBpath, destdir);
+	}
+	else if(action == "merge")
+	{
+		if(argc <= 3)
+			return help(prog_name, action);
+		
+		const string outpath = argv[2];
+		vector<string> DBpaths;
+		for(int k = 3; k < argc; ++k)
+			DBpaths.push_back(argv[k]);
+		
+		return merge(outpath, DBpaths);
+	}
 	else
 	{
 		cerr<<"unknown action \""<< action <<"\""<<endl;